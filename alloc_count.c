@@ -0,0 +1,42 @@
+/* alloc_count.c
+ *
+ * Counts heap allocations made by the program's own code. Linked with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc so calls from our objects
+ * reach the __wrap_ functions below, while allocations inside the C library
+ * (stdio buffers and the like) are left uncounted.
+ */
+
+#include <stddef.h>
+#include "alloc_count.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t count, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+
+static long num_allocs = 0;
+
+/*
+ * Returns the number of allocations made so far
+ */
+long alloc_count(void) {
+    return num_allocs;
+}
+
+void *__wrap_malloc(size_t size) {
+    num_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    num_allocs++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    num_allocs++;
+    return __real_realloc(ptr, size);
+}
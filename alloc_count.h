@@ -0,0 +1,13 @@
+/* alloc_count.h
+ *
+ * Header file for heap allocation counting.
+ * Only built into the *_allocs test binaries (see `make check-allocs`),
+ * which link with malloc, calloc and realloc wrapped by alloc_count.c.
+ */
+
+#ifndef _ALLOC_COUNT_H_
+#define _ALLOC_COUNT_H_
+
+long alloc_count(void);
+
+#endif
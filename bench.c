@@ -0,0 +1,709 @@
+/* bench.c
+ *
+ * Microbenchmark of the dictionary engines.
+ *
+ * To compile: make bench
+ * To run: ./bench input_file.csv [--queries N] [--engines name,name,...]
+ *         [--threads N] [--update N] [--ingest reader,reader,...]
+ *
+ * The dataset is read once. Each engine is then built from the loaded
+ * records and timed separately from parsing, and the heap it allocates while
+ * building is its memory footprint (the records themselves are shared by
+ * every engine and not counted). Five classes of queries are made from the
+ * dataset's keys:
+ *   exact        keys of records in the dataset
+ *   spell_start  the same keys with their first character changed
+ *   spell        the same keys with one character in the middle changed
+ *   spell_end    the same keys with their last character changed
+ *   miss         the same keys with a Q in front, so no key shares their
+ *                first byte
+ * The earlier a misspelling, the bigger the subtree the patricia spelling
+ * search has to score.
+ * Each class is run once untimed to warm up, then every query is timed on
+ * its own with clock_gettime, and the 50th, 99th and 99.9th percentile
+ * latencies are reported. The list engines have no spelling search, so for
+ * them a spell query is an exact search that misses; the patricia, succinct,
+ * patricia_qgram and patricia_bktree engines answer it with
+ * patricia_lookup_spell, the last two with a trigram index over the tree's
+ * keys or a BK-tree of them built as part of the engine. The BK-tree finds
+ * the closest key in the whole dictionary, the others only under the point
+ * where the query leaves the tree.
+ *
+ * Engines: linked, unrolled, packed_scalar, packed_avx2, patricia, succinct,
+ * patricia_qgram, patricia_bktree. With --threads every tree scores the keys
+ * of big spelling search subtrees on a pool of N threads.
+ * One CSV row per engine and query class goes to stdout:
+ *   engine,N,build_ms,memory_bytes,class,queries,hits,p50_ns,p99_ns,p999_ns,mean_ns
+ *
+ * --update N then times reads during a bulk update, as engine patricia_cow.
+ * A tree of the first half of the records is published, and a writer
+ * thread inserts the second half, publishing a version every N inserts,
+ * while the exact queries are run over and over on the newest version,
+ * pinned for each query, until the writer is done (class exact_update).
+ * The same queries are then timed with the writer gone (class exact_idle).
+ * Its build_ms is the first half's build, and memory_bytes the heap the
+ * tree uses once updated. The update's time and the nodes each version
+ * copied go to stderr. Without --engines, --update is the only measurement.
+ *
+ * --ingest reader,reader,... instead times loading the file with the
+ * ingest pipeline's reader back ends (stdio, pread, uring), throwing each
+ * record away as it arrives, so files far bigger than memory can be read.
+ * Each reader loads the file twice: first with it dropped from the page
+ * cache (cache cold), then again straight after (cache warm). One CSV row
+ * per load goes to stdout:
+ *   reader,cache,bytes,records,wall_ms,mb_per_s,reads,max_in_flight,
+ *   cached_at_start,reader_busy_ms,parser_busy_ms
+ */
+
+#define _POSIX_C_SOURCE 200112L // clock_gettime, pthreads
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "data.h"
+#include "list.h"
+#include "ulist.h"
+#include "scan.h"
+#include "patricia.h"
+#include "louds.h"
+#include "qgram.h"
+#include "bktree.h"
+#include "workpool.h"
+#include "ingest.h"
+
+/* Queries made for each class unless --queries says otherwise. */
+#define DEFAULT_QUERIES 1000
+
+#define NUM_CLASSES 5
+
+enum { CLASS_EXACT, CLASS_SPELL_START, CLASS_SPELL, CLASS_SPELL_END, CLASS_MISS };
+
+static const char *const class_names[NUM_CLASSES] = {"exact", "spell_start", "spell",
+                                                     "spell_end", "miss"};
+
+/*
+ * Records loaded from the dataset
+ * records: every record, in file order
+ * num_record: number of records
+*/
+typedef struct record_set {
+    address_t **records;
+    int num_record;
+} record_set_t;
+
+/*
+ * Succinct engine: exact lookups go to the encoding, spelling searches to
+ * the tree it was built from, which also owns the records' vectors
+*/
+typedef struct succinct_engine {
+    patricia_tree_t *tree;
+    louds_trie_t *trie;
+} succinct_engine_t;
+
+/*
+ * A dictionary engine under test
+ * name: name the engine is selected and reported by
+ * build: builds the engine from the loaded records
+ * lookup: searches for key, with spelling correction if spell is set and the
+ *         engine has it, returns the number of matching records
+ * destroy: frees the engine, leaving the records
+*/
+typedef struct bench_engine {
+    const char *name;
+    void *(*build)(const record_set_t *set);
+    int (*lookup)(void *dict, const char *key, int spell, record_span_t *matches);
+    void (*destroy)(void *dict);
+} bench_engine_t;
+
+static long long now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/*
+ * Bytes of heap in use, or 0 where the C library cannot tell
+ */
+static size_t heap_in_use(void) {
+#ifdef __GLIBC__
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+/* -- Engines -- */
+
+static void *build_linked(const record_set_t *set) {
+    list_t *list = create_list();
+    for (int i = 0; i < set->num_record; i++) {
+        insert_record(list, set->records[i]);
+    }
+    return list;
+}
+
+static int lookup_linked(void *dict, const char *key, int spell, record_span_t *matches) {
+    (void)spell;
+    return search_list_span(dict, key, matches, NULL, address_get_key);
+}
+
+static void destroy_linked(void *dict) {
+    free_list(dict, NULL);
+}
+
+static void *build_unrolled(const record_set_t *set) {
+    ulist_t *list = create_ulist();
+    for (int i = 0; i < set->num_record; i++) {
+        ulist_insert(list, set->records[i], address_get_key(set->records[i]));
+    }
+    return list;
+}
+
+static int lookup_unrolled(void *dict, const char *key, int spell, record_span_t *matches) {
+    (void)spell;
+    return search_ulist_span(dict, key, matches, NULL, address_get_key);
+}
+
+static void destroy_unrolled(void *dict) {
+    free_ulist(dict, NULL);
+}
+
+static void *build_packed(const record_set_t *set, int use_simd) {
+    packed_list_t *list = create_packed_list(use_simd);
+    for (int i = 0; i < set->num_record; i++) {
+        packed_insert(list, set->records[i], address_get_key(set->records[i]));
+    }
+    return list;
+}
+
+static void *build_packed_scalar(const record_set_t *set) {
+    return build_packed(set, 0);
+}
+
+static void *build_packed_avx2(const record_set_t *set) {
+    return build_packed(set, 1);
+}
+
+static int lookup_packed(void *dict, const char *key, int spell, record_span_t *matches) {
+    (void)spell;
+    return search_packed_span(dict, key, matches, NULL, address_get_key);
+}
+
+static void destroy_packed(void *dict) {
+    free_packed_list(dict, NULL);
+}
+
+/* Threads each tree's spelling search scores with, 0 for none, see --threads. */
+static int pool_threads = 0;
+
+static void *build_patricia(const record_set_t *set) {
+    patricia_tree_t *tree = create_patricia_tree();
+    if (pool_threads > 0) {
+        tree->pool = create_work_pool(pool_threads);
+    }
+    for (int i = 0; i < set->num_record; i++) {
+        const char *key = address_get_key(set->records[i]);
+        if (strlen(key) > 0) {
+            patricia_insert(tree, key, set->records[i]);
+        }
+    }
+    return tree;
+}
+
+static int lookup_patricia(void *dict, const char *key, int spell, record_span_t *matches) {
+    (void)matches;
+    const record_vec_t *records = spell ? patricia_lookup_spell(dict, key, NULL)
+                                        : patricia_lookup(dict, key, NULL);
+    return records ? records->num_record : 0;
+}
+
+static void destroy_patricia(void *dict) {
+    free_patricia_tree(dict, NULL);
+}
+
+static void *build_patricia_qgram(const record_set_t *set) {
+    patricia_tree_t *tree = build_patricia(set);
+    tree->grams = qgram_build(tree);
+    return tree;
+}
+
+static void *build_patricia_bktree(const record_set_t *set) {
+    patricia_tree_t *tree = build_patricia(set);
+    tree->bk = bktree_build(tree);
+    return tree;
+}
+
+static void *build_succinct(const record_set_t *set) {
+    succinct_engine_t *engine = malloc(sizeof(succinct_engine_t));
+    assert(engine);
+    engine->tree = build_patricia(set);
+    engine->trie = louds_from_patricia(engine->tree);
+    return engine;
+}
+
+static int lookup_succinct(void *dict, const char *key, int spell, record_span_t *matches) {
+    (void)matches;
+    succinct_engine_t *engine = dict;
+    const record_vec_t *records = louds_lookup(engine->trie, key, NULL);
+    if (records == NULL && spell) {
+        records = patricia_lookup_closest(engine->tree, key, NULL);
+    }
+    return records ? records->num_record : 0;
+}
+
+static void destroy_succinct(void *dict) {
+    succinct_engine_t *engine = dict;
+    free_louds_trie(engine->trie);
+    free_patricia_tree(engine->tree, NULL);
+    free(engine);
+}
+
+static const bench_engine_t engines[] = {
+    {"linked", build_linked, lookup_linked, destroy_linked},
+    {"unrolled", build_unrolled, lookup_unrolled, destroy_unrolled},
+    {"packed_scalar", build_packed_scalar, lookup_packed, destroy_packed},
+    {"packed_avx2", build_packed_avx2, lookup_packed, destroy_packed},
+    {"patricia", build_patricia, lookup_patricia, destroy_patricia},
+    {"succinct", build_succinct, lookup_succinct, destroy_succinct},
+    {"patricia_qgram", build_patricia_qgram, lookup_patricia, destroy_patricia},
+    {"patricia_bktree", build_patricia_bktree, lookup_patricia, destroy_patricia},
+};
+
+#define NUM_ENGINES ((int)(sizeof(engines) / sizeof(engines[0])))
+
+/* -- Queries -- */
+
+/*
+ * Makes num_queries queries of one class from the keys of records spread
+ * evenly over the dataset
+ */
+static char **make_queries(const record_set_t *set, int num_queries, int class) {
+    char **queries = malloc(num_queries * sizeof(char *));
+    assert(queries);
+
+    for (int i = 0; i < num_queries; i++) {
+        const char *key = address_get_key(set->records[(long)i * set->num_record / num_queries]);
+        size_t len = strlen(key);
+        char *query = malloc(len + 2);
+        assert(query);
+
+        if (class == CLASS_MISS) {
+            query[0] = 'Q';
+            strcpy(query + 1, key);
+        } else {
+            strcpy(query, key);
+            size_t pos = len / 2;
+            if (class == CLASS_SPELL_START) {
+                pos = 0;
+            } else if (class == CLASS_SPELL_END) {
+                pos = len - 1;
+            }
+            if (class != CLASS_EXACT && len > 0) {
+                query[pos] = query[pos] == 'A' ? 'B' : 'A';
+            }
+        }
+        queries[i] = query;
+    }
+    return queries;
+}
+
+static void free_queries(char **queries, int num_queries) {
+    for (int i = 0; i < num_queries; i++) {
+        free(queries[i]);
+    }
+    free(queries);
+}
+
+static int compare_ns(const void *a, const void *b) {
+    long long x = *(const long long *)a;
+    long long y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Latency at percentile p (0 to 1) of sorted latencies, nearest rank
+ */
+static long long percentile(const long long *sorted, int n, double p) {
+    int rank = (int)(p * n + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return sorted[(rank > n ? n : rank) - 1];
+}
+
+/*
+ * Prints the CSV row of n latencies, sorting them
+ */
+static void print_latency_row(const char *row_prefix, const char *class, long long *latencies,
+                              int n, int hits) {
+    long long total_ns = 0;
+    for (int i = 0; i < n; i++) {
+        total_ns += latencies[i];
+    }
+    qsort(latencies, n, sizeof(long long), compare_ns);
+    printf("%s,%s,%d,%d,%lld,%lld,%lld,%.1f\n", row_prefix, class, n, hits,
+           percentile(latencies, n, 0.50), percentile(latencies, n, 0.99),
+           percentile(latencies, n, 0.999), (double)total_ns / n);
+}
+
+/*
+ * Runs every query of one class against an engine and prints its CSV row
+ */
+static void bench_class(const bench_engine_t *engine, void *dict, int class, char **queries,
+                        int num_queries, long long *latencies, record_span_t *matches,
+                        const char *row_prefix) {
+    int spell = class != CLASS_EXACT && class != CLASS_MISS;
+
+    // Warm up: the same queries untimed, so every engine starts equally warm
+    for (int i = 0; i < num_queries; i++) {
+        engine->lookup(dict, queries[i], spell, matches);
+    }
+
+    int hits = 0;
+    for (int i = 0; i < num_queries; i++) {
+        long long start = now_ns();
+        int found = engine->lookup(dict, queries[i], spell, matches);
+        latencies[i] = now_ns() - start;
+        hits += found > 0;
+    }
+
+    print_latency_row(row_prefix, class_names[class], latencies, num_queries, hits);
+}
+
+/* -- Reads during an update -- */
+
+/*
+ * Writer of the --update measurement
+ * tree: the tree, published with the first half of the records
+ * set: the records, of which it inserts the second half
+ * publish_every: inserts between publishes
+ * num_versions: versions published
+ * num_copied, copied_bytes: nodes the versions copied, and the bytes the
+ *   copies took
+ * update_ms: time the inserts and publishes took
+ * done: set once the last version is published
+*/
+typedef struct update_writer {
+    patricia_tree_t *tree;
+    const record_set_t *set;
+    int publish_every;
+    int num_versions;
+    long num_copied;
+    size_t copied_bytes;
+    double update_ms;
+    int done;
+} update_writer_t;
+
+static void publish_update(update_writer_t *writer) {
+    patricia_version_t *version = patricia_publish(writer->tree);
+    writer->num_versions++;
+    writer->num_copied += version->num_copied;
+    writer->copied_bytes += version->copied_bytes;
+}
+
+static void *run_update_writer(void *arg) {
+    update_writer_t *writer = arg;
+    const record_set_t *set = writer->set;
+    long long start = now_ns();
+    int num_unpublished = 0;
+    for (int i = set->num_record / 2; i < set->num_record; i++) {
+        const char *key = address_get_key(set->records[i]);
+        if (strlen(key) == 0) {
+            continue;
+        }
+        patricia_insert(writer->tree, key, set->records[i]);
+        if (++num_unpublished == writer->publish_every) {
+            publish_update(writer);
+            num_unpublished = 0;
+        }
+    }
+    publish_update(writer);
+    writer->update_ms = (now_ns() - start) / 1e6;
+    __atomic_store_n(&writer->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/*
+ * Times one exact query on the tree's newest version, pinning it for the
+ * query as a reader would
+ */
+static long long time_pinned_lookup(patricia_tree_t *tree, const char *key, int *hits) {
+    long long start = now_ns();
+    patricia_version_t *version = patricia_pin(tree);
+    *hits += patricia_lookup(&version->view, key, NULL) != NULL;
+    patricia_unpin(tree, version);
+    return now_ns() - start;
+}
+
+/*
+ * Times exact queries on pinned versions while a writer updates the tree,
+ * and again once it has finished, see --update
+ */
+static void bench_update(const record_set_t *set, char **queries, int num_queries,
+                         int publish_every) {
+    size_t heap_before = heap_in_use();
+    long long start = now_ns();
+    patricia_tree_t *tree = create_patricia_tree();
+    for (int i = 0; i < set->num_record / 2; i++) {
+        const char *key = address_get_key(set->records[i]);
+        if (strlen(key) > 0) {
+            patricia_insert(tree, key, set->records[i]);
+        }
+    }
+    patricia_publish(tree);
+    double build_ms = (now_ns() - start) / 1e6;
+
+    // The queries go round until the writer has published its last version
+    update_writer_t writer = {tree, set, publish_every, 0, 0, 0, 0, 0};
+    int capacity = num_queries;
+    long long *latencies = malloc(capacity * sizeof(long long));
+    assert(latencies);
+    int num_timed = 0;
+    int hits = 0;
+    pthread_t thread;
+    int failed = pthread_create(&thread, NULL, run_update_writer, &writer);
+    assert(!failed);
+    for (int i = 0; !__atomic_load_n(&writer.done, __ATOMIC_ACQUIRE); i = (i + 1) % num_queries) {
+        if (num_timed == capacity) {
+            capacity *= 2;
+            latencies = realloc(latencies, capacity * sizeof(long long));
+            assert(latencies);
+        }
+        latencies[num_timed++] = time_pinned_lookup(tree, queries[i], &hits);
+    }
+    pthread_join(thread, NULL);
+    patricia_reclaim(tree);
+
+    fprintf(stderr, "update: %d records in %.3f ms, %d versions, %.1f nodes (%.0f bytes) "
+            "copied per version\n", set->num_record - set->num_record / 2, writer.update_ms,
+            writer.num_versions, (double)writer.num_copied / writer.num_versions,
+            (double)writer.copied_bytes / writer.num_versions);
+    print_version_stats(stderr, tree);
+
+    char row_prefix[128];
+    snprintf(row_prefix, sizeof(row_prefix), "patricia_cow,%d,%.3f,%zu", set->num_record,
+             build_ms, heap_in_use() - heap_before);
+    print_latency_row(row_prefix, "exact_update", latencies, num_timed, hits);
+
+    hits = 0;
+    for (int i = 0; i < num_queries; i++) {
+        latencies[i] = time_pinned_lookup(tree, queries[i], &hits);
+    }
+    print_latency_row(row_prefix, "exact_idle", latencies, num_queries, hits);
+
+    free(latencies);
+    free_patricia_tree(tree, NULL);
+}
+
+/*
+ * Returns 1 if name is in the comma separated list, or the list is NULL
+ */
+static int engine_selected(const char *list, const char *name) {
+    if (list == NULL) {
+        return 1;
+    }
+    size_t len = strlen(name);
+    for (const char *p = list; p != NULL; p = strchr(p, ',')) {
+        if (*p == ',') {
+            p++;
+        }
+        if (strncmp(p, name, len) == 0 && (p[len] == ',' || p[len] == '\0')) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Inserter for the load benchmark, counting records and throwing them away
+ */
+static void discard_record(void *count, void *address) {
+    (*(long *)count)++;
+    address_free(address);
+}
+
+/*
+ * Times loading the file with each reader back end named in readers, cold
+ * then warm
+ */
+static int bench_ingest(const char *path, const char *readers) {
+    printf("reader,cache,bytes,records,wall_ms,mb_per_s,reads,max_in_flight,"
+           "cached_at_start,reader_busy_ms,parser_busy_ms\n");
+    for (int r = INGEST_STDIO; r <= INGEST_URING; r++) {
+        if (!engine_selected(readers, ingest_reader_name(r))) {
+            continue;
+        }
+        for (int warm = 0; warm <= 1; warm++) {
+            FILE *f = fopen(path, "r");
+            if (!f) {
+                perror("Error opening input file");
+                return EXIT_FAILURE;
+            }
+            if (!warm && ingest_drop_cache(f) != 0) {
+                fprintf(stderr, "Could not drop %s from the page cache\n", path);
+            }
+            long count = 0;
+            ingest_stats_t stats;
+            ingest_pipeline(f, r, &count, discard_record, &stats);
+            fclose(f);
+
+            print_ingest_stats(stderr, &stats);
+            double wall_s = stats.wall_ns / 1e9;
+            printf("%s,%s,%lld,%ld,%.3f,%.1f,%ld,%d,%.3f,%.3f,%.3f\n",
+                   ingest_reader_name(stats.back_end), warm ? "warm" : "cold",
+                   stats.reader.items, count, stats.wall_ns / 1e6,
+                   wall_s > 0 ? stats.reader.items / wall_s / 1e6 : 0.0, stats.num_reads,
+                   stats.max_in_flight, stats.cached_fraction, stats.reader.busy_ns / 1e6,
+                   stats.parser.busy_ns / 1e6);
+            fflush(stdout);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s input_file [--queries N] [--engines name,name,...] "
+                "[--threads N] [--update N] [--ingest reader,reader,...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int num_queries = DEFAULT_QUERIES;
+    const char *selected = NULL;
+    int publish_every = 0;
+    const char *readers = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--queries") == 0 && i + 1 < argc) {
+            num_queries = atoi(argv[++i]);
+            if (num_queries <= 0) {
+                fprintf(stderr, "--queries needs a positive number\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            pool_threads = atoi(argv[++i]);
+            if (pool_threads <= 0 || pool_threads > WORK_POOL_MAX_THREADS) {
+                fprintf(stderr, "--threads needs a number from 1 to %d\n", WORK_POOL_MAX_THREADS);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--update") == 0 && i + 1 < argc) {
+            publish_every = atoi(argv[++i]);
+            if (publish_every <= 0) {
+                fprintf(stderr, "--update needs a positive number\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--engines") == 0 && i + 1 < argc) {
+            selected = argv[++i];
+        } else if (strcmp(argv[i], "--ingest") == 0 && i + 1 < argc) {
+            readers = argv[++i];
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (readers != NULL) {
+        return bench_ingest(argv[1], readers);
+    }
+
+    if (selected != NULL) {
+        // Every name in the list has to select an engine
+        int num_names = 1;
+        int num_selected = 0;
+        for (const char *p = selected; (p = strchr(p, ',')) != NULL; p++) {
+            num_names++;
+        }
+        for (int e = 0; e < NUM_ENGINES; e++) {
+            num_selected += engine_selected(selected, engines[e].name);
+        }
+        if (num_selected != num_names) {
+            fprintf(stderr, "Unknown engine in %s\n", selected);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE *inFile = fopen(argv[1], "r");
+    if (!inFile) {
+        perror("Error opening input file");
+        return EXIT_FAILURE;
+    }
+
+    // Load phase: parse the whole dataset once
+    record_set_t set = {NULL, 0};
+    int capacity = 0;
+    size_t heap_before = heap_in_use();
+    long long start = now_ns();
+    address_t *addr;
+    while ((addr = data_read(inFile)) != NULL) {
+        if (set.num_record == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            set.records = realloc(set.records, capacity * sizeof(address_t *));
+            assert(set.records);
+        }
+        set.records[set.num_record++] = addr;
+    }
+    fclose(inFile);
+    fprintf(stderr, "loaded %d records in %.3f ms, %zu bytes\n", set.num_record,
+            (now_ns() - start) / 1e6, heap_in_use() - heap_before);
+
+    if (set.num_record == 0) {
+        fprintf(stderr, "No records in %s\n", argv[1]);
+        free(set.records);
+        return EXIT_FAILURE;
+    }
+
+    char **queries[NUM_CLASSES];
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        queries[c] = make_queries(&set, num_queries, c);
+    }
+    long long *latencies = malloc(num_queries * sizeof(long long));
+    assert(latencies);
+    record_span_t matches;
+    init_span(&matches, MATCHES_CAPACITY);
+
+    printf("engine,N,build_ms,memory_bytes,class,queries,hits,p50_ns,p99_ns,p999_ns,mean_ns\n");
+    for (int e = 0; e < NUM_ENGINES; e++) {
+        if (!engine_selected(selected, engines[e].name) || (selected == NULL && publish_every > 0)) {
+            continue;
+        }
+
+        // Build phase
+        heap_before = heap_in_use();
+        start = now_ns();
+        void *dict = engines[e].build(&set);
+        double build_ms = (now_ns() - start) / 1e6;
+        size_t memory = heap_in_use() - heap_before;
+
+        char row_prefix[128];
+        snprintf(row_prefix, sizeof(row_prefix), "%s,%d,%.3f,%zu", engines[e].name,
+                 set.num_record, build_ms, memory);
+
+        // Query phase
+        for (int c = 0; c < NUM_CLASSES; c++) {
+            bench_class(&engines[e], dict, c, queries[c], num_queries, latencies, &matches,
+                        row_prefix);
+        }
+        fflush(stdout);
+        engines[e].destroy(dict);
+    }
+    if (publish_every > 0) {
+        bench_update(&set, queries[CLASS_EXACT], num_queries, publish_every);
+    }
+
+    free_span(&matches);
+    free(latencies);
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        free_queries(queries[c], num_queries);
+    }
+    for (int i = 0; i < set.num_record; i++) {
+        address_free(set.records[i]);
+    }
+    free(set.records);
+
+    return EXIT_SUCCESS;
+}
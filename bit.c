@@ -7,6 +7,7 @@
  */
 
 #include "bit.h"
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
@@ -36,47 +37,39 @@ int getBit(const char *s, unsigned int bitIndex){
 }
 
 /*
- * Compares two strings bit by bit and counts comparisons until first mismatch
+ * Compares two strings bit by bit and counts comparisons until first mismatch.
+ * The count is worked out a word at a time rather than bit by bit: the first
+ * byte where the strings differ is found 8 bytes at a time, and the number of
+ * equal leading bits within it is the number of leading zeros of the XOR of
+ * the two bytes. The shorter string's null byte always differs from the other
+ * string, so the mismatch is never past the end of the shorter string, and
+ * identical strings count every bit including the null byte.
 */
 int count_bit_comparisons(const char *key_1, const char *key_2) {
-    int bit_count = 0;
-    int len_1 = strlen(key_1) + 1; // Add 1 for null byte
-    int len_2 = strlen(key_2) + 1;
-    int max_len;
+    size_t len_1 = strlen(key_1) + 1; // Add 1 for null byte
+    size_t len_2 = strlen(key_2) + 1;
+    size_t min_len = len_1 < len_2 ? len_1 : len_2;
 
-    // max_len is whichever string is longer
-    if (len_1 > len_2) {
-        max_len = len_1;
-    } else {
-        max_len = len_2;
-    }
-
-    // Compare bit by bit
-    for (int bit_index = 0; bit_index < max_len * BITS_PER_BYTE; bit_index++) {
-        bit_count++;
-
-        // Get individual bits using the provided getBit function
-        int bit_1;
-        if (bit_index < len_1 * BITS_PER_BYTE) {
-            bit_1 = getBit(key_1, bit_index);
-        } else {
-            bit_1 = 0;
-        }
-
-        int bit_2;
-        if (bit_index < len_2 * BITS_PER_BYTE) {
-            bit_2 = getBit(key_2, bit_index);
-        } else {
-            bit_2 = 0;
+    // Skip whole words that are equal
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= min_len; i += sizeof(uint64_t)) {
+        uint64_t word_1, word_2;
+        memcpy(&word_1, key_1 + i, sizeof(word_1));
+        memcpy(&word_2, key_2 + i, sizeof(word_2));
+        if (word_1 != word_2) {
+            break;
         }
+    }
 
-        // If bits differ, stop here
-        if (bit_1 != bit_2) {
-            return bit_count;
+    // Find the differing byte, then the differing bit within it
+    for (; i < min_len; i++) {
+        unsigned int diff = (unsigned char)key_1[i] ^ (unsigned char)key_2[i];
+        if (diff != 0) {
+            int leading_equal = __builtin_clz(diff) - (int)(sizeof(unsigned int) - 1) * BITS_PER_BYTE;
+            return i * BITS_PER_BYTE + leading_equal + 1;
         }
     }
 
     // If we arrive here, strings are identical
-    return bit_count;
-
+    return min_len * BITS_PER_BYTE;
 }
@@ -0,0 +1,227 @@
+/* bktree.c
+ *
+ * Implementation of the BK-tree spelling index.
+ *
+ * The keys are taken from the patricia tree in ascending order and inserted
+ * in that order, so node i holds key i and the root is the smallest key.
+ * Nodes live in one array and link their children through next_sibling.
+ * The closest key search is depth first with an explicit stack, pushing the
+ * children whose edge can still lead to a key as close as the best so far,
+ * most promising last, and checking that bound again when a node is popped,
+ * since the best may have improved meanwhile.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "bktree.h"
+#include "counters.h"
+
+/*
+ * Keys and records collected from the tree, see bktree_build
+ */
+typedef struct key_collector {
+    bk_tree_t *bk;
+    int capacity;
+} key_collector_t;
+
+static void collect_key(const char *key, const record_vec_t *records, void *ctx) {
+    key_collector_t *collector = ctx;
+    bk_tree_t *bk = collector->bk;
+    if (bk->num_keys == collector->capacity) {
+        collector->capacity = collector->capacity ? collector->capacity * 2 : 1024;
+        bk->keys = realloc(bk->keys, collector->capacity * sizeof(char *));
+        bk->records = realloc(bk->records, collector->capacity * sizeof(record_vec_t *));
+        assert(bk->keys && bk->records);
+    }
+
+    size_t len = strlen(key);
+    char *copy = malloc(len + 1);
+    assert(copy);
+    memcpy(copy, key, len + 1);
+    bk->keys[bk->num_keys] = copy;
+    bk->records[bk->num_keys] = records;
+    bk->num_keys++;
+}
+
+/*
+ * Hangs key id under the root, following the edges labelled with its
+ * distance to each node's key until one is missing.
+ * Returns the depth it was added at.
+ */
+static int insert_key(bk_tree_t *bk, int id) {
+    bk_node_t *node = &bk->nodes[id];
+    node->key = id;
+    node->first_child = -1;
+    node->next_sibling = -1;
+    if (bk->root == -1) {
+        bk->root = id;
+        node->distance = 0;
+        return 0;
+    }
+
+    int current = bk->root;
+    for (int depth = 1;; depth++) {
+        int distance = patricia_key_distance(bk->keys[id], bk->keys[bk->nodes[current].key]);
+        int child = bk->nodes[current].first_child;
+        while (child != -1 && bk->nodes[child].distance != distance) {
+            child = bk->nodes[child].next_sibling;
+        }
+        if (child == -1) {
+            node->distance = distance;
+            node->next_sibling = bk->nodes[current].first_child;
+            bk->nodes[current].first_child = id;
+            return depth;
+        }
+        current = child;
+    }
+}
+
+/**
+ * Builds the BK-tree of every key in a tree. The BK-tree describes the tree
+ * as it is now: once the tree changes, spelling searches go back to the
+ * trie until it is rebuilt.
+ *
+ * tree: The tree whose keys to index.
+ *
+ * Returns: The new BK-tree, to be given to free_bktree.
+ */
+bk_tree_t *bktree_build(patricia_tree_t *tree) {
+    assert(tree);
+    bk_tree_t *bk = calloc(1, sizeof(bk_tree_t));
+    assert(bk);
+    bk->root = -1;
+    bk->generation = tree->generation;
+
+    key_collector_t collector = {bk, 0};
+    patricia_for_each(tree, collect_key, &collector);
+
+    bk->nodes = malloc((bk->num_keys + 1) * sizeof(bk_node_t));
+    bk->stack = malloc((bk->num_keys + 1) * sizeof(bk_pending_t));
+    assert(bk->nodes && bk->stack);
+    for (int i = 0; i < bk->num_keys; i++) {
+        int depth = insert_key(bk, i);
+        if (depth > bk->depth) {
+            bk->depth = depth;
+        }
+    }
+    return bk;
+}
+
+/**
+ * Finds the closest key in the whole dictionary to the query, by edit
+ * distance, the smallest key winning a tie. Makes no heap allocations.
+ *
+ * bk: The BK-tree, searched by one thread at a time.
+ * key: The query, normalised if the tree normalises keys.
+ * distance: Set to the closest key's distance to the query.
+ *
+ * Returns: The closest key's records, or NULL if there are no keys.
+ */
+const record_vec_t *bktree_closest(bk_tree_t *bk, const char *key, int *distance,
+                                   search_results_t *results) {
+    assert(bk && key && distance);
+    if (bk->root == -1) {
+        return NULL;
+    }
+
+    int best = -1;
+    int best_distance = 0;
+    int num_distances = 0;
+    int size = 0;
+    bk->stack[size++] = (bk_pending_t){bk->root, 0};
+
+    while (size > 0) {
+        bk_pending_t pending = bk->stack[--size];
+        // A tie can still win if its key is smaller
+        if (best != -1 && (pending.bound > best_distance ||
+                           (pending.bound == best_distance && pending.node > best))) {
+            continue;
+        }
+
+        const bk_node_t *node = &bk->nodes[pending.node];
+        int d = patricia_key_distance(key, bk->keys[node->key]);
+        COUNT_LOCAL(num_distances, 1);
+        if (best == -1 || d < best_distance || (d == best_distance && node->key < best)) {
+            best = node->key;
+            best_distance = d;
+        }
+
+        // Children with the smallest bound go on top, so the closest region
+        // is searched first and the best distance shrinks early
+        int pushed = size;
+        for (int child = node->first_child; child != -1; child = bk->nodes[child].next_sibling) {
+            int bound = abs(bk->nodes[child].distance - d);
+            if (bound > best_distance) {
+                continue;
+            }
+            int i = size++;
+            while (i > pushed && bk->stack[i - 1].bound < bound) {
+                bk->stack[i] = bk->stack[i - 1];
+                i--;
+            }
+            bk->stack[i] = (bk_pending_t){child, bound};
+        }
+    }
+
+    COUNT(results, string_comps, num_distances);
+    bk->stats.distances += num_distances;
+    *distance = best_distance;
+    return bk->records[best];
+}
+
+/**
+ * Returns the bytes the BK-tree uses, its keys included
+ */
+size_t bktree_memory_bytes(const bk_tree_t *bk) {
+    assert(bk);
+    size_t n = bk->num_keys + 1;
+    size_t bytes = sizeof(bk_tree_t) +
+                   n * (sizeof(char *) + sizeof(record_vec_t *) + sizeof(bk_node_t) +
+                        sizeof(bk_pending_t));
+    for (int i = 0; i < bk->num_keys; i++) {
+        bytes += strlen(bk->keys[i]) + 1;
+    }
+    return bytes;
+}
+
+/*
+ * Prints the BK-tree's size, the distance computations and time of its
+ * spelling searches, and how they compare with the trie's
+ */
+void print_bktree_stats(FILE *f, const bk_tree_t *bk) {
+    assert(f && bk);
+    const bk_stats_t *stats = &bk->stats;
+    long n = stats->num_searches ? stats->num_searches : 1;
+    fprintf(f, "bktree: %d keys, depth %d, %zu bytes\n", bk->num_keys, bk->depth,
+            bktree_memory_bytes(bk));
+    fprintf(f, "bktree: %ld spelling searches, %.1f distance computations (%.2f%% of keys), "
+            "%.1f us per search\n", stats->num_searches, (double)stats->distances / n,
+            bk->num_keys ? 100.0 * stats->distances / n / bk->num_keys : 0.0,
+            stats->ns / 1e3 / n);
+    if (bk->compare) {
+        fprintf(f, "bktree: trie search %.1f distance computations, %.1f us per search\n",
+                (double)stats->trie_distances / n, stats->trie_ns / 1e3 / n);
+        fprintf(f, "bktree: same key as the trie %ld, another key as close %ld, closer key %ld\n",
+                stats->same_key, stats->same_distance, stats->closer);
+    }
+    if (stats->num_stale > 0) {
+        fprintf(f, "bktree: %ld searches after the tree changed went to the trie\n",
+                stats->num_stale);
+    }
+}
+
+void free_bktree(bk_tree_t *bk) {
+    if (bk == NULL) {
+        return;
+    }
+    for (int i = 0; i < bk->num_keys; i++) {
+        free(bk->keys[i]);
+    }
+    free(bk->keys);
+    free(bk->records);
+    free(bk->nodes);
+    free(bk->stack);
+    free(bk);
+}
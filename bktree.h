@@ -0,0 +1,106 @@
+/* bktree.h
+ *
+ * Header file for the BK-tree over a dictionary's distinct keys, a metric
+ * index for the spelling search. Every child of a node hangs off an edge
+ * labelled with its key's edit distance to the node's key. By the triangle
+ * inequality a key within r edits of the query can only lie under the edges
+ * labelled d - r to d + r, where d is the query's distance to the node, so
+ * a search for the closest key skips every other edge.
+ *
+ * Unlike the trie's spelling search, which only scores the keys under the
+ * point where the query left the tree, the BK-tree finds the closest key in
+ * the whole dictionary.
+ */
+
+#ifndef _BKTREE_H_
+#define _BKTREE_H_
+
+#include <stdio.h>
+#include "patricia.h"
+
+/*
+ * A key of the tree
+ * key: index of the key in the tree's keys
+ * distance: edit distance to the parent's key, the label of its edge
+ * first_child, next_sibling: the node's children, linked, -1 for none
+*/
+typedef struct bk_node {
+    int key;
+    int distance;
+    int first_child;
+    int next_sibling;
+} bk_node_t;
+
+/*
+ * Node waiting to be searched, with the fewest edits its key can be from
+ * the query
+*/
+typedef struct bk_pending {
+    int node;
+    int bound;
+} bk_pending_t;
+
+/*
+ * Measurements of the spelling searches answered by a BK-tree, and of the
+ * trie's search over the same queries when compare is set
+ * num_searches: spelling searches answered
+ * num_stale: searches left to the trie because the tree changed since the
+ *   BK-tree was built
+ * distances, ns: distance computations and time of the BK-tree searches
+ * trie_distances, trie_ns: the same for the trie's searches
+ * same_key: searches both found the same key for
+ * same_distance: searches they found different keys at the same distance for
+ * closer: searches the BK-tree found a closer key for
+*/
+typedef struct bk_stats {
+    long num_searches;
+    long num_stale;
+    long long distances;
+    long long ns;
+    long long trie_distances;
+    long long trie_ns;
+    long same_key;
+    long same_distance;
+    long closer;
+} bk_stats_t;
+
+/*
+ * BK-tree over the keys of a patricia tree
+ * num_keys: number of keys, in ascending order, node i holds key i
+ * keys: each key as stored in the tree
+ * records: each key's records in the tree
+ * nodes: the nodes, node 0 is the root
+ * root: first node to search, -1 if there are no keys
+ * depth: edges on the longest path from the root
+ * generation: the tree generation the BK-tree was built at
+ * compare: if set, every spelling search also runs the trie's search and
+ *   the two are compared in stats
+ * stack: room for one search's pending nodes, so an index must not be
+ *   searched by two threads at once
+ * stats: what the searches did
+*/
+typedef struct bk_tree {
+    int num_keys;
+    char **keys;
+    const record_vec_t **records;
+    bk_node_t *nodes;
+    int root;
+    int depth;
+    unsigned long generation;
+    int compare;
+    bk_pending_t *stack;
+    bk_stats_t stats;
+} bk_tree_t;
+
+bk_tree_t *bktree_build(patricia_tree_t *tree);
+
+const record_vec_t *bktree_closest(bk_tree_t *bk, const char *key, int *distance,
+                                   search_results_t *results);
+
+size_t bktree_memory_bytes(const bk_tree_t *bk);
+
+void print_bktree_stats(FILE *f, const bk_tree_t *bk);
+
+void free_bktree(bk_tree_t *bk);
+
+#endif
@@ -0,0 +1,240 @@
+/* bloom.c
+ *
+ * Implementation of the blocked Bloom filter.
+ *
+ * A key's 64 bit hash picks its block with its high half, and the key's
+ * bits in the block are 9 bit slices of the hash remixed. Slices keep the
+ * bits of different keys independent; stepping through the block with a
+ * stride from the hash (double hashing) lined them up, and gave twice the
+ * false positives the filter was sized for.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "bloom.h"
+
+/* Bit positions, of 9 bits each, taken from one 64 bit hash. */
+#define BLOOM_BITS_PER_HASH 7
+
+/*
+ * Returns log2(x) for x >= 1, by counting halvings for the integer part
+ * and repeated squaring for the fraction
+ */
+static double log2_of(double x) {
+    assert(x >= 1);
+    double result = 0;
+    while (x >= 2) {
+        x /= 2;
+        result += 1;
+    }
+    double bit = 0.5;
+    for (int i = 0; i < 20; i++) {
+        x *= x;
+        if (x >= 2) {
+            x /= 2;
+            result += bit;
+        }
+        bit /= 2;
+    }
+    return result;
+}
+
+/*
+ * Returns e^x for x <= 0, halving x until its Taylor series converges and
+ * squaring back, so the filter needs no libm
+ */
+static double exp_of(double x) {
+    assert(x <= 0);
+    int halvings = 0;
+    while (x < -0.5) {
+        x /= 2;
+        halvings++;
+    }
+    double result = 1, term = 1;
+    for (int i = 1; i < 16; i++) {
+        term *= x / i;
+        result += term;
+    }
+    while (halvings-- > 0) {
+        result *= result;
+    }
+    return result;
+}
+
+/*
+ * Number of bits a key sets that gives the fewest false positives for a
+ * number of bits per key, bits_per_key times ln 2
+ */
+static int hashes_for_bits(double bits_per_key) {
+    int num_hashes = (int)(bits_per_key * 0.6931 + 0.5);
+    if (num_hashes < 1) {
+        return 1;
+    }
+    return num_hashes > BLOOM_MAX_HASHES ? BLOOM_MAX_HASHES : num_hashes;
+}
+
+/*
+ * Expected false positive rate of a blocked filter. The keys in a block
+ * follow a Poisson distribution, and a block with i keys, each setting
+ * about num_hashes bits, passes an absent key with probability
+ * (1 - (1 - num_hashes / BLOOM_BLOCK_BITS)^i)^num_hashes.
+ */
+static double blocked_fpr(double bits_per_key, int num_hashes) {
+    double mean = BLOOM_BLOCK_BITS / bits_per_key;
+    double probability = exp_of(-mean); // of a block with i keys
+    double unset = 1; // chance a bit is unset in a block with i keys
+    double fpr = 0;
+    for (int i = 0; i < mean * 4 + 64; i++) {
+        double passes = 1;
+        for (int h = 0; h < num_hashes; h++) {
+            passes *= 1 - unset;
+        }
+        fpr += probability * passes;
+        probability *= mean / (i + 1);
+        unset *= 1 - (double)num_hashes / BLOOM_BLOCK_BITS;
+    }
+    return fpr;
+}
+
+/**
+ * Returns the bits per key a filter needs for a false positive rate. Busier
+ * blocks give more false positives than the same bits spread evenly would,
+ * so it counts up in tenths of a bit from the plain Bloom filter's
+ * log2(1 / fpr) / ln 2 until the blocked filter's expected rate is met.
+ */
+double bloom_bits_for_rate(double fpr) {
+    assert(fpr > 0 && fpr < 1);
+    double bits = log2_of(1 / fpr) * 1.4427;
+    while (blocked_fpr(bits, hashes_for_bits(bits)) > fpr && bits < 64) {
+        bits += 0.1;
+    }
+    return bits;
+}
+
+/*
+ * 64 bit FNV-1a, mixed by the MurmurHash3 finaliser so every output bit
+ * depends on every input byte
+ */
+static uint64_t hash_key(const char *key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        hash = (hash ^ *p) * 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static uint64_t *key_block(const bloom_filter_t *filter, uint64_t hash) {
+    uint32_t block = ((hash >> 32) * filter->num_blocks) >> 32;
+    return filter->blocks + (size_t)block * BLOOM_BLOCK_WORDS;
+}
+
+/*
+ * Remixes a hash for more bits, the splitmix64 step
+ */
+static uint64_t next_bits(uint64_t hash) {
+    hash += 0x9E3779B97F4A7C15ULL;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+/**
+ * Creates an empty filter for expected_keys keys with bits_per_key bits
+ * each.
+ */
+bloom_filter_t *create_bloom_filter(long expected_keys, double bits_per_key) {
+    assert(expected_keys >= 0 && bits_per_key > 0);
+    bloom_filter_t *filter = calloc(1, sizeof(bloom_filter_t));
+    assert(filter);
+
+    double num_bits = expected_keys * bits_per_key;
+    filter->num_blocks = (uint32_t)(num_bits / BLOOM_BLOCK_BITS) + 1;
+    filter->bits_per_key = bits_per_key;
+    filter->num_hashes = hashes_for_bits(bits_per_key);
+
+    filter->blocks = calloc((size_t)filter->num_blocks * BLOOM_BLOCK_WORDS, sizeof(uint64_t));
+    assert(filter->blocks);
+    return filter;
+}
+
+void bloom_add(bloom_filter_t *filter, const char *key) {
+    assert(filter && key);
+    uint64_t hash = hash_key(key);
+    uint64_t *block = key_block(filter, hash);
+    uint64_t bits = next_bits(hash);
+
+    for (int i = 0; i < filter->num_hashes; i++) {
+        if (i % BLOOM_BITS_PER_HASH == 0 && i > 0) {
+            bits = next_bits(bits);
+        }
+        uint32_t bit = (bits >> (i % BLOOM_BITS_PER_HASH) * 9) % BLOOM_BLOCK_BITS;
+        block[bit / 64] |= 1ULL << (bit % 64);
+    }
+    filter->num_keys++;
+}
+
+/**
+ * Checks a key against the filter.
+ *
+ * Returns: 0 if the key was certainly never added, 1 if it may have been.
+ */
+int bloom_maybe_contains(bloom_filter_t *filter, const char *key) {
+    assert(filter && key);
+    uint64_t hash = hash_key(key);
+    const uint64_t *block = key_block(filter, hash);
+    uint64_t bits = next_bits(hash);
+    filter->num_checked++;
+
+    for (int i = 0; i < filter->num_hashes; i++) {
+        if (i % BLOOM_BITS_PER_HASH == 0 && i > 0) {
+            bits = next_bits(bits);
+        }
+        uint32_t bit = (bits >> (i % BLOOM_BITS_PER_HASH) * 9) % BLOOM_BLOCK_BITS;
+        if (!(block[bit / 64] & (1ULL << (bit % 64)))) {
+            filter->num_rejected++;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+size_t bloom_memory_bytes(const bloom_filter_t *filter) {
+    assert(filter);
+    return sizeof(bloom_filter_t) + (size_t)filter->num_blocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+}
+
+/*
+ * Prints the filter's size and what its checks found. Of the keys the
+ * dictionary did not have, the share the filter passed is the observed
+ * false positive rate.
+ */
+void print_bloom_stats(FILE *f, const bloom_filter_t *filter) {
+    assert(f && filter);
+    fprintf(f, "bloom filter: %ld keys, %zu bytes (%.1f bits per key), %d hashes", filter->num_keys,
+            bloom_memory_bytes(filter), filter->bits_per_key, filter->num_hashes);
+    if (filter->target_fpr > 0) {
+        fprintf(f, ", sized for %.4f false positives", filter->target_fpr);
+    }
+    fprintf(f, "\n");
+
+    long absent = filter->num_rejected + filter->num_false_positives;
+    fprintf(f, "bloom filter: %ld checks, %ld definite misses skipped the search, "
+            "%ld false positives (observed rate %.4f)\n", filter->num_checked,
+            filter->num_rejected, filter->num_false_positives,
+            absent ? (double)filter->num_false_positives / absent : 0.0);
+}
+
+void free_bloom_filter(bloom_filter_t *filter) {
+    if (filter == NULL) {
+        return;
+    }
+    free(filter->blocks);
+    free(filter);
+}
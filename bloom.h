@@ -0,0 +1,62 @@
+/* bloom.h
+ *
+ * Header file for the blocked Bloom filter over a dictionary's keys.
+ * Every key sets its bits in one 512 bit block, a cache line, chosen by its
+ * hash, so a membership check reads one line of memory. A key the filter
+ * has no bits for was certainly never added; a key it has all bits for
+ * probably was, wrongly so at about the false positive rate it was sized
+ * for.
+ */
+
+#ifndef _BLOOM_H_
+#define _BLOOM_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Bits in a block, and 64 bit words in one. */
+#define BLOOM_BLOCK_BITS 512
+#define BLOOM_BLOCK_WORDS (BLOOM_BLOCK_BITS / 64)
+
+/* Most bits a key sets. */
+#define BLOOM_MAX_HASHES 16
+
+/*
+ * Blocked Bloom filter
+ * blocks: num_blocks blocks of BLOOM_BLOCK_WORDS words
+ * num_blocks: number of blocks
+ * num_hashes: bits each key sets in its block
+ * bits_per_key: bits the filter was sized with for each expected key
+ * target_fpr: false positive rate it was sized for, 0 if sized by bits
+ * num_keys: keys added
+ * num_checked, num_rejected: keys checked, and ones found certainly absent
+ * num_false_positives: keys passed that the dictionary then did not have,
+ *   counted by the dictionary
+*/
+typedef struct bloom_filter {
+    uint64_t *blocks;
+    uint32_t num_blocks;
+    int num_hashes;
+    double bits_per_key;
+    double target_fpr;
+    long num_keys;
+    long num_checked;
+    long num_rejected;
+    long num_false_positives;
+} bloom_filter_t;
+
+double bloom_bits_for_rate(double fpr);
+
+bloom_filter_t *create_bloom_filter(long expected_keys, double bits_per_key);
+
+void bloom_add(bloom_filter_t *filter, const char *key);
+
+int bloom_maybe_contains(bloom_filter_t *filter, const char *key);
+
+size_t bloom_memory_bytes(const bloom_filter_t *filter);
+
+void print_bloom_stats(FILE *f, const bloom_filter_t *filter);
+
+void free_bloom_filter(bloom_filter_t *filter);
+
+#endif
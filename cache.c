@@ -0,0 +1,202 @@
+/* cache.c
+ *
+ * Implementation of the LRU query result cache.
+ *
+ * Entries are found through a chained hash table on the query string and
+ * kept on a doubly linked list in recency order, so a lookup, an insert and
+ * an eviction are all O(1). The cache remembers the generation of the tree
+ * it was filled from; any insert or delete bumps the tree's generation, and
+ * the next lookup then empties the cache before answering. That is also
+ * what lets entries point at the records in the tree's nodes instead of
+ * copying them: nodes only change or move when the generation does.
+ *
+ * The entries are one array made with the cache, the evicted entry is
+ * reused for the new query, and keys are held in the entries, so nothing is
+ * allocated once the cache exists.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "cache.h"
+
+/*
+ * FNV-1a hash of a query string
+ */
+static unsigned int hash_key(const char *key) {
+    unsigned int hash = 2166136261u;
+    for (; *key; key++) {
+        hash ^= (unsigned char)*key;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Creates an empty cache holding at most capacity queries
+ */
+query_cache_t *create_query_cache(int capacity) {
+    assert(capacity > 0);
+    query_cache_t *cache = malloc(sizeof(query_cache_t));
+    assert(cache);
+    cache->entries = malloc(capacity * sizeof(cache_entry_t));
+    assert(cache->entries);
+
+    // Keep the load factor at or below one half
+    cache->num_buckets = 1;
+    while (cache->num_buckets < 2u * capacity) {
+        cache->num_buckets *= 2;
+    }
+    cache->buckets = calloc(cache->num_buckets, sizeof(cache_entry_t *));
+    assert(cache->buckets);
+
+    cache->head = NULL;
+    cache->tail = NULL;
+    cache->num_entry = 0;
+    cache->capacity = capacity;
+    cache->generation = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->invalidations = 0;
+
+    return cache;
+}
+
+/*
+ * Takes an entry off the recency list
+ */
+static void unlink_entry(query_cache_t *cache, cache_entry_t *entry) {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
+    }
+}
+
+/*
+ * Puts an entry at the most recently used end of the recency list
+ */
+static void push_front(query_cache_t *cache, cache_entry_t *entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head) {
+        cache->head->prev = entry;
+    } else {
+        cache->tail = entry;
+    }
+    cache->head = entry;
+}
+
+/*
+ * Takes the least recently used entry out of the cache
+ * Returns: The entry, free for reuse
+ */
+static cache_entry_t *evict(query_cache_t *cache) {
+    cache_entry_t *victim = cache->tail;
+    assert(victim);
+
+    cache_entry_t **link = &cache->buckets[hash_key(victim->key) & (cache->num_buckets - 1)];
+    while (*link != victim) {
+        link = &(*link)->hash_next;
+    }
+    *link = victim->hash_next;
+
+    unlink_entry(cache, victim);
+    return victim;
+}
+
+/**
+ * Cached front end to patricia_search_spell
+ *
+ * cache: The cache to consult and fill
+ * tree: The tree searched on a miss
+ * key: The query string
+ * results: Set to the counts of the search that produced the matches, so
+ *          output is the same with or without the cache
+ *
+ * Returns: The matching records, borrowed from the tree until it next
+ *          changes, or NULL if none
+ */
+const record_vec_t *cache_search_spell(query_cache_t *cache, patricia_tree_t *tree,
+                                      const char *key, search_results_t *results) {
+    assert(cache && tree && key);
+
+    // The tree changed since these results were computed, none can be trusted
+    if (cache->generation != tree->generation) {
+        if (cache->num_entry > 0) {
+            cache->invalidations++;
+        }
+        cache_clear(cache);
+        cache->generation = tree->generation;
+    }
+
+    unsigned int bucket = hash_key(key) & (cache->num_buckets - 1);
+    for (cache_entry_t *entry = cache->buckets[bucket]; entry; entry = entry->hash_next) {
+        if (strcmp(entry->key, key) == 0) {
+            cache->hits++;
+            unlink_entry(cache, entry);
+            push_front(cache, entry);
+            if (results) {
+                *results = entry->results;
+            }
+            return entry->matches;
+        }
+    }
+
+    // Not cached, search and remember the answer
+    cache->misses++;
+    search_results_t searched = {0};
+    const record_vec_t *found = patricia_lookup_spell(tree, key, &searched);
+    if (results) {
+        *results = searched;
+    }
+
+    size_t key_len = strlen(key);
+    if (key_len >= CACHE_KEY_MAX) {
+        return found; // Too long to hold
+    }
+
+    cache_entry_t *entry;
+    if (cache->num_entry < cache->capacity) {
+        entry = &cache->entries[cache->num_entry++];
+    } else {
+        entry = evict(cache);
+    }
+    memcpy(entry->key, key, key_len + 1);
+    entry->matches = found;
+    entry->results = searched;
+    entry->hash_next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    push_front(cache, entry);
+
+    return found;
+}
+
+/*
+ * Removes every entry, keeping the counters
+ */
+void cache_clear(query_cache_t *cache) {
+    assert(cache);
+    memset(cache->buckets, 0, cache->num_buckets * sizeof(cache_entry_t *));
+    cache->head = NULL;
+    cache->tail = NULL;
+    cache->num_entry = 0;
+}
+
+/*
+ * Frees the cache and every entry in it
+ */
+void free_query_cache(query_cache_t *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    free(cache->entries);
+    free(cache->buckets);
+    free(cache);
+}
@@ -0,0 +1,73 @@
+/* cache.h
+ *
+ * Header file for the query result cache.
+ * Keeps the results of the most recently used queries so repeated lookups,
+ * including repeated misspellings, skip the tree search entirely.
+ * Entries are allocated together when the cache is created and borrow the
+ * tree's records, so a lookup, hit or miss, allocates nothing.
+ */
+
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include "list.h"
+#include "patricia.h"
+
+/* Longest query, with its terminator, that the cache holds. Longer ones are
+ * searched every time. */
+#define CACHE_KEY_MAX 256
+
+/*
+ * A cached query
+ * key: the query string
+ * matches: the records the query found, borrowed from the tree and valid
+ *          while the tree's generation is the cache's, or NULL for none
+ * results: the comparison counts of the search that filled the entry
+ * hash_next: next entry in the same hash bucket
+ * prev, next: neighbours in recency order, most recent at the head
+*/
+typedef struct cache_entry cache_entry_t;
+
+struct cache_entry {
+    char key[CACHE_KEY_MAX];
+    const record_vec_t *matches;
+    search_results_t results;
+    cache_entry_t *hash_next;
+    cache_entry_t *prev;
+    cache_entry_t *next;
+};
+
+/*
+ * LRU cache of query results
+ * entries: every entry, allocated up front, the first num_entry in use
+ * buckets: hash table of entries, num_buckets is a power of two
+ * head, tail: most and least recently used entries
+ * num_entry, capacity: entries held and the most that may be held
+ * generation: the tree generation the entries were computed at
+ * hits, misses: lookups answered from and not found in the cache
+ * invalidations: times the cache was emptied because the tree changed
+*/
+typedef struct query_cache {
+    cache_entry_t *entries;
+    cache_entry_t **buckets;
+    unsigned int num_buckets;
+    cache_entry_t *head;
+    cache_entry_t *tail;
+    int num_entry;
+    int capacity;
+    unsigned long generation;
+    long hits;
+    long misses;
+    long invalidations;
+} query_cache_t;
+
+query_cache_t *create_query_cache(int capacity);
+
+const record_vec_t *cache_search_spell(query_cache_t *cache, patricia_tree_t *tree,
+                                      const char *key, search_results_t *results);
+
+void cache_clear(query_cache_t *cache);
+
+void free_query_cache(query_cache_t *cache);
+
+#endif
@@ -0,0 +1,30 @@
+/* counters.h
+ *
+ * Header file for the comparison counters the searches keep for the
+ * experiments (bit, node and string comparisons).
+ * Building with -DNO_COUNTERS compiles every count out of the searches,
+ * including the work done only to produce a count, and the counts then all
+ * read zero. Without it the counts are exact.
+ */
+
+#ifndef _COUNTERS_H_
+#define _COUNTERS_H_
+
+#ifdef NO_COUNTERS
+
+/* The operands stay in an unevaluated sizeof, so nothing is computed but
+ * the variables only used for counting are still referenced. */
+#define COUNT(results, field, n) ((void)sizeof((results)->field += (n)))
+#define COUNT_LOCAL(counter, n) ((void)sizeof((counter) += (n)))
+
+#else
+
+/* Adds n to results->field, if there is a results struct to add to. */
+#define COUNT(results, field, n) do { if (results) { (results)->field += (n); } } while (0)
+
+/* Adds n to a local counter, n is not evaluated when counting is off. */
+#define COUNT_LOCAL(counter, n) ((counter) += (n))
+
+#endif
+
+#endif
@@ -5,12 +5,18 @@
  * Supports quoted fields and basic CSV escape sequences for robust data handling.
  */
 
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 #include "data.h"
 #include "list.h"
+#ifdef COUNT_ALLOCS
+#include "alloc_count.h"
+#endif
 
 /*
  * Gets the key of the address
@@ -55,6 +61,26 @@ void address_print_file(FILE* output_file, void *address) {
     fprintf(output_file, "\n");
 }
 
+/*
+ * Writes the record to f as one line of the dataset's CSV. Fields with a
+ * comma are quoted, so parse_line reads the line back field for field.
+*/
+void address_write_csv(FILE *f, const address_t *address) {
+    assert(f && address);
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        const char *field = address->fields[i];
+        if (i > 0) {
+            fputc(',', f);
+        }
+        if (strchr(field, ',')) {
+            fprintf(f, "\"%s\"", field);
+        } else {
+            fputs(field, f);
+        }
+    }
+    fputc('\n', f);
+}
+
 /*
  * Frees an address record
 */
@@ -67,6 +93,19 @@ void address_free(void *address) {
     free(address);
 }
 
+/*
+ * Adds an address record's struct and field strings to stats
+*/
+void address_memory_stats(const void *address, memory_stats_t *stats) {
+    const address_t *addr = (const address_t *)address;
+    assert(addr && stats);
+
+    stats->record_bytes += sizeof(address_t);
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        stats->field_bytes += strlen(addr->fields[i]) + 1;
+    }
+}
+
 /*
  * Parse CSV line into field array
 */
@@ -110,32 +149,13 @@ int parse_line(char *line, char *fields[], int max_fields) {
 }
 
 /*
- * Reads a single line from the input CSV and returns a pointer to an address_t struct
+ * Parses one CSV line, without its newline, into a new address record. The
+ * line is modified in place.
+ * Returns the record, or NULL if it could not be allocated.
 */
-address_t *data_read(FILE *input_file) {
-    static int header_read = 0;
-    char line[MAX_LINE_LENGTH];
+address_t *data_parse(char *line) {
     char *fields[FIELD_COUNT];
 
-    // Skip header line upon first call
-    if (!header_read) {
-        if (fgets(line, sizeof(line), input_file) == NULL) {
-            return NULL;
-        }
-        header_read = 1;
-    }
-
-    // Read line
-    if (fgets(line, sizeof(line), input_file) == NULL) {
-        return NULL;
-    }
-
-    // Remove newline character if present
-    char *newline = strchr(line, '\n');
-    if (newline) {
-        *newline = '\0';
-    }
-
     // Pase csv line into temporary fields
     int field_count = parse_line(line, fields, FIELD_COUNT);
 
@@ -161,23 +181,65 @@ address_t *data_read(FILE *input_file) {
 }
 
 /*
- * Build an address dictionary 
+ * Reads a single line from the input CSV and returns a pointer to an address_t struct
 */
-void buildDictionary(FILE *f, list_t *dictionary) {
+address_t *data_read(FILE *input_file) {
+    static int header_read = 0;
+    char line[MAX_LINE_LENGTH];
+
+    // Skip header line upon first call
+    if (!header_read) {
+        if (fgets(line, sizeof(line), input_file) == NULL) {
+            return NULL;
+        }
+        header_read = 1;
+    }
+
+    // Read line
+    if (fgets(line, sizeof(line), input_file) == NULL) {
+        return NULL;
+    }
+
+    // Remove newline character if present
+    char *newline = strchr(line, '\n');
+    if (newline) {
+        *newline = '\0';
+    }
+
+    return data_parse(line);
+}
+
+/*
+ * Build an address dictionary, adding each address with insert
+*/
+void buildDictionary(FILE *f, void *dictionary, void (*insert)(void *dictionary, void *address)) {
     address_t *addr;
     
     // Read addresses one by one using data_read
     while ((addr = data_read(f)) != NULL) {
-        insert_record(dictionary, addr);
+        insert(dictionary, addr);
     }
 }
 
 /*
  * Prints out the matches from each key to the output file. 
+ * dict is searched with search, the time spent searching goes to stderr.
+ * If profiler is not NULL, each search is profiled and its measurements
+ * follow the comparison counts on stdout.
  */ 
-void output_results(list_t *dict, FILE *output_file) {   
+void output_results(void *dict, dict_search_t search, query_profiler_t *profiler,
+                    FILE *output_file) {   
     char line[MAX_LINE_LENGTH]; // To hold the line from stdin
-    assert(dict);
+    assert(dict && search);
+    int num_queries = 0;
+    double search_ms = 0;
+
+    // Matches of every query go into this one buffer, so queries do not allocate
+    record_span_t matches;
+    init_span(&matches, MATCHES_CAPACITY);
+#ifdef COUNT_ALLOCS
+    long allocs_before = alloc_count();
+#endif
 
     // Process queries from stdin until EOF
     while (fgets(line, sizeof(line), stdin)) { // getting line from stdin 
@@ -189,20 +251,45 @@ void output_results(list_t *dict, FILE *output_file) {
         int comparisons[3] = {0, 0, 0};
         int comps = 0;
 
-        // Searches the dict for the matching records and then stores them in a linked list
-        list_t *matches = search_list(dict, line, &comps, comparisons, address_get_key);
+        // Searches the dict for the matching records and then stores them in the span
+        struct timespec start, end;
+        perf_sample_t sample;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (profiler) {
+            profiler_start(profiler);
+        }
+        comps = search(dict, line, &matches, comparisons);
+        if (profiler) {
+            profiler_stop(profiler, &sample);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        search_ms += (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6;
 
-        // Prints to the output file the address from each node
-        for(node_t *cur = matches->head; cur != NULL; cur = cur->next){
-            address_print_file(output_file, cur->data);
+        // Prints to the output file each matching address
+        for (int i = 0; i < matches.num_record; i++) {
+            address_print_file(output_file, matches.records[i]);
         }
 
         // Print comparison results to stdout
-        printf("%s --> %d records found - comparisons: b%d n%d s%d\n",
+        printf("%s --> %d records found - comparisons: b%d n%d s%d",
                 line, comps, comparisons[0], comparisons[1], comparisons[2]);
-                
-        free_list(matches, NULL);
+        if (profiler) {
+            profiler_print_sample(stdout, profiler, &sample);
+        }
+        printf("\n");
+        num_queries++;
+    }
+
+#ifdef COUNT_ALLOCS
+    fprintf(stderr, "%ld heap allocations in %d queries\n",
+            alloc_count() - allocs_before, num_queries);
+#endif
+    // Kept off stdout for analyse.pl
+    fprintf(stderr, "%d queries - searches took %.3f ms\n", num_queries, search_ms);
+    if (profiler) {
+        profiler_print_summary(stderr, profiler);
     }
+    free_span(&matches);
 
 }
 
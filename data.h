@@ -11,10 +11,13 @@
 
 #include <stdio.h>
 #include "list.h"
+#include "perf.h"
 
 #define FIELD_COUNT 35
 
-#define MAX_LINE_LENGTH 512
+#define MAX_LINE_LENGTH 8192
+/* Starting size of the buffers query results are written to. */
+#define MATCHES_CAPACITY 64
 #define X_POS 33
 #define Y_POS 34
 
@@ -24,17 +27,32 @@ typedef struct { // contains all the fields from each row in the csv
 
 address_t *data_read(FILE *input_file);
 
+address_t *data_parse(char *line);
+
 const char *address_get_key(const void *address);
 
 void address_print_file(FILE *output_file, void *address);
 
+void address_write_csv(FILE *f, const address_t *address);
+
 void address_free(void *address);
 
+void address_memory_stats(const void *address, memory_stats_t *stats);
+
 int parse_line(char *line, char *fields[], int max_fields);
 
-void buildDictionary(FILE *f, list_t *dictionary);
+/*
+ * Searches a dictionary for key, writing the matching records to matches and
+ * the bit, node and string comparison counts to comparisons[0..2]
+ * Returns the number of matching records
+ */
+typedef int (*dict_search_t)(void *dict, const char *key, record_span_t *matches,
+                             int *comparisons);
+
+void buildDictionary(FILE *f, void *dictionary, void (*insert)(void *dictionary, void *address));
 
-void output_results(list_t *dict, FILE *output_file);
+void output_results(void *dict, dict_search_t search, query_profiler_t *profiler,
+                    FILE *output_file);
 
 void chomp(char *s);
 #endif
@@ -8,8 +8,41 @@
  * Stage 2 implements Patricia tree insertion and spellchecking.
  *
  * To compile: make -B dict2
- * To run: ./dict2 2 input_file.csv output_file.txt
+ * To run: ./dict2 2 input_file.csv output_file.txt [options]
  * Then enter search queries on stdin, one per line.
+ *
+ * Options:
+ *   --normalize   match keys case-insensitively, ignoring extra whitespace
+ *                 and road type abbreviations
+ *   --succinct    answer exact matches from a succinct (LOUDS) encoding of
+ *                 the key set, falling back to the tree for spelling
+ *   --cache N     keep the results of the N most recently used queries
+ *   --batch N     look up N queries at a time with interleaved traversal
+ *   --profile     report hardware counters for every search
+ *   --stats       report the memory the tree and its records use, key
+ *                 depths and stem lengths
+ *   --pipeline    load the dataset with separate reader, parser and
+ *                 inserter stages, reporting each stage's throughput
+ *   --reader R    read the dataset in the pipeline with stdio, pread or
+ *                 uring (io_uring); implies --pipeline
+ *   --cold        drop the dataset from the page cache before loading it
+ *   --qgram       find spelling candidates in big subtrees with a trigram
+ *                 index rather than scoring every key in them
+ *   --bktree      answer spelling searches with the closest key in the whole
+ *                 dictionary from a BK-tree, comparing each answer, its
+ *                 distance computations and time with the trie's search
+ *   --threads N   score the keys of big spelling search subtrees on N
+ *                 threads
+ *   --bloom FPR   check every exact search against a Bloom filter of the
+ *                 keys sized for false positive rate FPR, so definite misses
+ *                 skip the descent
+ *   --bloom-bits B  size the Bloom filter with B bits per key instead
+ *   --wal DIR     keep a write-ahead log in DIR: stdin lines "+" and a
+ *                 dataset row insert the row, "-" and a key delete the key,
+ *                 and both survive a restart. The dictionary is loaded from
+ *                 the newest snapshot in DIR and the log replayed over it.
+ *   --wal-batch N flush the log to disk once for every N updates
+ *   --compact-every N  fold the log into a new snapshot every N updates
  */
 
 #include <stdio.h>
@@ -19,11 +52,133 @@
 #include "list.h"
 #include "data.h" 
 #include "patricia.h"
+#include "louds.h"
+#include "cache.h"
+#include "ingest.h"
+#include "qgram.h"
+#include "bktree.h"
+#include "workpool.h"
+#include "bloom.h"
+#include "wal.h"
+
+/*
+ * Adds a key's length, with its null byte, to the running total in ctx
+ */
+static void add_key_bytes(const char *key, const record_vec_t *records, void *ctx) {
+    (void)records;
+    *(size_t *)ctx += strlen(key) + 1;
+}
 
 int main(int argc, char *argv[]) {
 	//Make sure we have at least 4 tokens in the command line
 	if (argc < 4) {
-        fprintf(stderr, "Usage: %s stage input_file output_file\n", argv[0]);
+        fprintf(stderr, "Usage: %s stage input_file output_file [--normalize] [--succinct] [--cache N] [--batch N] [--profile] [--stats] [--pipeline] [--reader stdio|pread|uring] [--cold] [--qgram] [--bktree] [--threads N] [--bloom FPR] [--bloom-bits B] [--wal DIR] [--wal-batch N] [--compact-every N]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int normalize = 0;
+    int succinct = 0;
+    int cache_size = 0;
+    int batch_size = 0;
+    int profile = 0;
+    int stats = 0;
+    int pipeline = 0;
+    ingest_reader_t reader = INGEST_STDIO;
+    int cold = 0;
+    int qgram = 0;
+    int bktree = 0;
+    int num_threads = 0;
+    double bloom_fpr = 0;
+    double bloom_bits = 0;
+    char *wal_dir = NULL;
+    int wal_batch = 1;
+    long compact_every = 0;
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--normalize") == 0) {
+            normalize = 1;
+        } else if (strcmp(argv[i], "--succinct") == 0) {
+            succinct = 1;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = 1;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            pipeline = 1;
+        } else if (strcmp(argv[i], "--reader") == 0 && i + 1 < argc) {
+            if (!ingest_reader_from_name(argv[++i], &reader)) {
+                fprintf(stderr, "Reader must be stdio, pread or uring\n");
+                return EXIT_FAILURE;
+            }
+            pipeline = 1;
+        } else if (strcmp(argv[i], "--cold") == 0) {
+            cold = 1;
+        } else if (strcmp(argv[i], "--qgram") == 0) {
+            qgram = 1;
+        } else if (strcmp(argv[i], "--bktree") == 0) {
+            bktree = 1;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_size = atoi(argv[++i]);
+            if (batch_size <= 0) {
+                fprintf(stderr, "Batch size must be positive\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+            if (num_threads <= 0 || num_threads > WORK_POOL_MAX_THREADS) {
+                fprintf(stderr, "Number of threads must be from 1 to %d\n", WORK_POOL_MAX_THREADS);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--bloom") == 0 && i + 1 < argc) {
+            bloom_fpr = atof(argv[++i]);
+            if (bloom_fpr <= 0 || bloom_fpr >= 1) {
+                fprintf(stderr, "False positive rate must be between 0 and 1\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--bloom-bits") == 0 && i + 1 < argc) {
+            bloom_bits = atof(argv[++i]);
+            if (bloom_bits <= 0) {
+                fprintf(stderr, "Bits per key must be positive\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--wal") == 0 && i + 1 < argc) {
+            wal_dir = argv[++i];
+        } else if (strcmp(argv[i], "--wal-batch") == 0 && i + 1 < argc) {
+            wal_batch = atoi(argv[++i]);
+            if (wal_batch <= 0) {
+                fprintf(stderr, "Log batch size must be positive\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--compact-every") == 0 && i + 1 < argc) {
+            compact_every = atol(argv[++i]);
+            if (compact_every <= 0) {
+                fprintf(stderr, "Compaction interval must be positive\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_size = atoi(argv[++i]);
+            if (cache_size <= 0) {
+                fprintf(stderr, "Cache size must be positive\n");
+                return EXIT_FAILURE;
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (profile && batch_size > 0) {
+        // Batched lookups share their traversal, there is no single search to measure
+        fprintf(stderr, "--profile measures single searches, it cannot be used with --batch\n");
+        return EXIT_FAILURE;
+    }
+    if (cache_size > 0 && (succinct || batch_size > 0)) {
+        // Only single searches of the tree go through the cache
+        fprintf(stderr, "--cache holds the results of single searches, it cannot be used with --succinct or --batch\n");
+        return EXIT_FAILURE;
+    }
+    if (wal_dir && (succinct || batch_size > 0)) {
+        // Both read their queries without looking for updates among them
+        fprintf(stderr, "--wal applies updates between single searches, it cannot be used with --succinct or --batch\n");
         return EXIT_FAILURE;
     }
 
@@ -36,6 +191,14 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    // With a log, the dictionary is loaded from its newest snapshot
+    wal_t *wal = NULL;
+    if (wal_dir) {
+        wal = wal_open(wal_dir, input_filename, wal_batch);
+        wal->compact_every = compact_every;
+        input_filename = (char *)wal_snapshot_path(wal);
+    }
+
     // Open files
 	FILE *inFile = fopen(input_filename, "r");
     if (!inFile) {
@@ -50,14 +213,98 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    if (cold && ingest_drop_cache(inFile) != 0) {
+        fprintf(stderr, "Could not drop the dataset from the page cache\n");
+    }
+
     // Create dictionary and build it
     patricia_tree_t *dictionary = create_patricia_tree();
-    build_patricia_dictionary(inFile, dictionary);
+    dictionary->normalize = normalize;
+    if (pipeline) {
+        ingest_stats_t ingest;
+        ingest_pipeline(inFile, reader, dictionary, patricia_insert_address, &ingest);
+        print_ingest_stats(stderr, &ingest);
+    } else {
+        build_patricia_dictionary(inFile, dictionary);
+    }
+    if (wal) {
+        wal_replay(wal, dictionary);
+    }
+
+    if (stats) {
+        memory_stats_t memory;
+        patricia_memory_stats(dictionary, &memory, address_memory_stats);
+        print_memory_stats(stderr, &memory);
+    }
+
+    if (qgram) {
+        dictionary->grams = qgram_build(dictionary);
+    }
+    if (bloom_fpr > 0 || bloom_bits > 0) {
+        double bits = bloom_bits > 0 ? bloom_bits : bloom_bits_for_rate(bloom_fpr);
+        patricia_build_filter(dictionary, bits, bloom_bits > 0 ? 0 : bloom_fpr);
+    }
+    if (num_threads > 0) {
+        dictionary->pool = create_work_pool(num_threads);
+    }
+    if (bktree) {
+        dictionary->bk = bktree_build(dictionary);
+        dictionary->bk->compare = 1;
+    }
+
+    query_profiler_t *profiler = NULL;
+    if (profile) {
+        profiler = create_query_profiler();
+    }
 
     // Process all queries froms stdin
-    process_patricia_queries(dictionary, outFile);
+    if (succinct) {
+        louds_trie_t *encoding = louds_from_patricia(dictionary);
+
+        // The tree stays for the spelling search, so the encoding adds to its
+        // memory. Its size is set against what holds the same keys already:
+        // the raw keys, and the tree's stems and nodes.
+        size_t key_bytes = 0;
+        patricia_for_each(dictionary, add_key_bytes, &key_bytes);
+        memory_stats_t tree_memory;
+        patricia_memory_stats(dictionary, &tree_memory, NULL);
+        fprintf(stderr, "succinct key set: %u keys, %u edges, %zu bytes "
+                "(%zu with values) - raw keys %zu bytes - tree stems %zu bytes, "
+                "nodes %zu bytes, kept for the spelling search\n",
+                encoding->num_keys, encoding->num_edges,
+                louds_memory_bytes(encoding, 0), louds_memory_bytes(encoding, 1), key_bytes,
+                tree_memory.stem_bytes, tree_memory.node_bytes);
+
+        process_succinct_queries(encoding, dictionary, profiler, outFile);
+        free_louds_trie(encoding);
+    } else if (batch_size > 0) {
+        process_patricia_batch_queries(dictionary, batch_size, outFile);
+    } else {
+        query_cache_t *cache = NULL;
+        if (cache_size > 0) {
+            cache = create_query_cache(cache_size);
+        }
+        process_patricia_queries(dictionary, cache, wal, profiler, outFile);
+        free_query_cache(cache);
+    }
+
+    if (qgram) {
+        print_qgram_stats(stderr, dictionary->grams);
+    }
+    if (bktree) {
+        print_bktree_stats(stderr, dictionary->bk);
+    }
+    if (dictionary->filter != NULL) {
+        print_bloom_stats(stderr, dictionary->filter);
+    }
+    if (wal) {
+        wal_sync(wal);
+        print_wal_stats(stderr, wal);
+    }
 
     // Free all allocated memory
+    free_query_profiler(profiler);
+    wal_close(wal);
     free_patricia_tree(dictionary, address_free); 
 
     fclose(outFile);
@@ -29,3 +29,30 @@ plt.tight_layout()
 output_filename = 'experiment2_graph.png'
 plt.savefig(output_filename)
 print(f"\nTime comparison graph successfully saved to '{output_filename}'")
+
+# --- 5. Lookup latency from the engine microbenchmark (Experiment 9) ---
+BENCH_CSV = "analysed/experiment9/bench_results.csv"
+try:
+    bench = pd.read_csv(BENCH_CSV)
+except FileNotFoundError:
+    print(f"Skipping latency graph, '{BENCH_CSV}' not found (run 'run_experiment9.sh')")
+    exit()
+
+classes = ['exact', 'spell', 'miss']
+fig, axes = plt.subplots(1, len(classes), figsize=(15, 5), sharey=True)
+for ax, query_class in zip(axes, classes):
+    rows = bench[bench['class'] == query_class]
+    for engine, group in rows.groupby('engine', sort=False):
+        line, = ax.plot(group['N'], group['p50_ns'], 'o-', label=f'{engine} p50')
+        ax.plot(group['N'], group['p99_ns'], '--', color=line.get_color(), label=f'{engine} p99')
+    ax.set_title(f'{query_class} queries', fontsize=14)
+    ax.set_xlabel('Number of Records in Dataset (N)', fontsize=12)
+    ax.set_yscale('log')
+    ax.grid(True, which="both", ls="--", linewidth=0.5)
+axes[0].set_ylabel('Lookup Latency (ns)', fontsize=12)
+axes[-1].legend(fontsize=8)
+plt.tight_layout()
+
+latency_filename = 'experiment2_latency_graph.png'
+plt.savefig(latency_filename)
+print(f"Latency graph successfully saved to '{latency_filename}'")
@@ -0,0 +1,521 @@
+/* gen_dataset.c
+ *
+ * Generator of synthetic Vicmap-shaped address datasets for scale testing.
+ *
+ * To compile: make gen_dataset
+ * To run: ./gen_dataset rows output.csv queries.in [options]
+ *
+ * Writes rows address records with the 35 columns of tests/dataset_1067.csv
+ * and a query file for them. The same arguments always give the same files.
+ * Keys are built like the real EZI_ADD: an optional unit, a house number, a
+ * road name and type, the locality and its postcode, e.g.
+ * "12/87 KELVALE STREET BRANDOWIN 3141". Road and locality names are made
+ * of syllables from a fixed vocabulary.
+ *
+ * Options:
+ *   --seed S          random seed (default 1)
+ *   --roads N         number of distinct road names (default 5000)
+ *   --localities N    number of distinct localities (default 400)
+ *   --key-len L       mean key length in bytes, the road names are sized to
+ *                     reach it (default 37, about the real data's)
+ *   --prefix-share P  fraction of records that take the unit, number and
+ *                     road of a recent record in another locality, so the
+ *                     two keys share everything up to the locality
+ *                     (default 0.2)
+ *   --dup-ratio D     fraction of records that repeat the key of a recent
+ *                     record under a new PFI (default 0.02)
+ *   --queries Q       number of queries (default 10000)
+ *   --hit H           fraction of queries that are keys in the dataset
+ *                     (default 0.6)
+ *   --misspell M      fraction of queries that are keys in the dataset with
+ *                     one edit: a letter changed, dropped, added or swapped
+ *                     with the next (default 0.2); the rest are misses,
+ *                     house numbers no record has on otherwise real roads
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+/* Longest key written. */
+#define MAX_KEY_LEN 250
+
+/* Longest mean key length allowed. The key and the ROAD_NAME column both grow
+ * with it, this keeps lines to a few hundred bytes. */
+#define MAX_MEAN_KEY_LEN 160
+
+#define MAX_NAME_LEN 160
+
+/* Number of recent records that prefix sharing and duplicates draw from. */
+#define RECENT_RECORDS 1024
+
+/* House numbers of generated records are below this, misses at or above. */
+#define MAX_HOUSE_NUMBER 2000
+
+/* Roughly the length of a key without its road name. */
+#define KEY_FIXED_LEN 28
+
+#define NUM_ROAD_TYPES 14
+
+static const char *const road_types[NUM_ROAD_TYPES] = {
+    "STREET", "ROAD", "AVENUE", "COURT", "DRIVE", "CRESCENT", "PLACE",
+    "WAY", "PARADE", "LANE", "GROVE", "CLOSE", "BOULEVARD", "HIGHWAY"
+};
+
+#define NUM_SYLLABLES 32
+
+static const char *const syllables[NUM_SYLLABLES] = {
+    "AL", "BAR", "BEL", "BRAN", "CAM", "DOW", "ELL", "FERN", "GLEN", "HAR",
+    "KEL", "LAN", "MAR", "MOOR", "NOR", "OAK", "PARK", "QUIN", "RED", "ROS",
+    "SAN", "STON", "TAR", "TON", "VALE", "WAL", "WIN", "WOOD", "YAR", "ING",
+    "LEY", "DALE"
+};
+
+/*
+ * Generator settings
+ * rows: number of records to write
+ * seed: random seed
+ * num_roads: number of distinct road names
+ * num_localities: number of distinct localities
+ * key_len: mean key length to aim for
+ * prefix_share: fraction of records sharing a recent record's prefix
+ * dup_ratio: fraction of records repeating a recent record's key
+ * num_queries: number of queries to write
+ * hit_ratio: fraction of queries that are keys in the dataset
+ * misspell_ratio: fraction of queries that are misspelled keys
+*/
+typedef struct gen_options {
+    long rows;
+    uint64_t seed;
+    int num_roads;
+    int num_localities;
+    int key_len;
+    double prefix_share;
+    double dup_ratio;
+    int num_queries;
+    double hit_ratio;
+    double misspell_ratio;
+} gen_options_t;
+
+/*
+ * The parts of a record its key and columns are made from
+ * unit: unit number, 0 if none
+ * number: house number
+ * road, road_type, locality: indices into the vocabularies
+*/
+typedef struct gen_address {
+    int unit;
+    int number;
+    int road;
+    int road_type;
+    int locality;
+} gen_address_t;
+
+/* -- Random numbers -- */
+
+/*
+ * splitmix64: advances state and returns the next 64 random bits
+ */
+static uint64_t next_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * Random integer in [0, n)
+ */
+static long random_below(uint64_t *state, long n) {
+    return (long)(next_random(state) % (uint64_t)n);
+}
+
+/*
+ * Random double in [0, 1)
+ */
+static double random_unit(uint64_t *state) {
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* -- Vocabulary -- */
+
+/*
+ * Makes count distinct names of about target_len bytes from syllables.
+ * Each name starts with its number written in base NUM_SYLLABLES, so few
+ * repeat, and is padded with random syllables.
+ */
+static char **make_names(uint64_t *state, int count, int target_len) {
+    char **names = malloc(count * sizeof(char *));
+    assert(names);
+
+    for (int i = 0; i < count; i++) {
+        char name[MAX_NAME_LEN + 1] = "";
+        size_t len = 0;
+
+        // Distinct stem: the digits of i in base NUM_SYLLABLES
+        int digits = i;
+        do {
+            const char *syllable = syllables[digits % NUM_SYLLABLES];
+            strcat(name, syllable);
+            len += strlen(syllable);
+            digits /= NUM_SYLLABLES;
+        } while (digits > 0);
+
+        // Random tail up to the target length, give or take a syllable
+        int len_goal = target_len - 3 + (int)random_below(state, 5);
+        while ((int)len < len_goal && len + 4 <= MAX_NAME_LEN) {
+            const char *syllable = syllables[random_below(state, NUM_SYLLABLES)];
+            strcat(name, syllable);
+            len += strlen(syllable);
+        }
+
+        names[i] = malloc(len + 1);
+        assert(names[i]);
+        strcpy(names[i], name);
+    }
+    return names;
+}
+
+static void free_names(char **names, int count) {
+    for (int i = 0; i < count; i++) {
+        free(names[i]);
+    }
+    free(names);
+}
+
+/* -- Records -- */
+
+/*
+ * Writes the key of address to key, returns its length
+ */
+static int format_key(char *key, const gen_address_t *address, char **roads, char **localities) {
+    char unit[16] = "";
+    if (address->unit > 0) {
+        snprintf(unit, sizeof(unit), "%d/", address->unit);
+    }
+    int len = snprintf(key, MAX_KEY_LEN + 1, "%s%d %s %s %s %d", unit, address->number,
+                       roads[address->road], road_types[address->road_type],
+                       localities[address->locality], 3000 + address->locality);
+    return len > MAX_KEY_LEN ? MAX_KEY_LEN : len;
+}
+
+/*
+ * Writes one record's 35 columns as a CSV line
+ */
+static void write_record(FILE *f, long pfi, const char *key, const gen_address_t *address,
+                         char **roads, char **localities, uint64_t *state) {
+    static const char *const access_types[] = {"L", "L", "L", "S"};
+    char unit_id[16] = "";
+    if (address->unit > 0) {
+        snprintf(unit_id, sizeof(unit_id), "%d.0", address->unit);
+    }
+
+    // Localities are spread over Victoria, each road a little within its locality
+    double x = 141.0 + (address->locality % 97) * 0.05 + (address->road % 101) * 0.0004
+               + random_unit(state) * 0.0005;
+    double y = -34.5 - (address->locality % 89) * 0.045 - (address->road % 103) * 0.0004
+               - random_unit(state) * 0.0005;
+
+    // PFI,EZI_ADD,SRC_VERIF,PROPSTATUS,GCODEFEAT,LOC_DESC,BLGUNTTYP,HSAUNITID,
+    // BUNIT_PRE1..BUNIT_SUF2,FLOOR_TYPE,FLOOR_NO_1,FLOOR_NO_2,BUILDING,COMPLEX,
+    // HSE_PREF1..HSE_SUF2,DISP_NUM1,ROAD_NAME,ROAD_TYPE,RD_SUF,LOCALITY,STATE,
+    // POSTCODE,ACCESSTYPE,x,y
+    fprintf(f, "%ld,%s,20%02ld-%02ld-%02ld,A,%s,%s,%s,,,%s,,,,,,,,,,,%d.0,,,,,,%s,%s,,%s,VIC,%d,%s,"
+               "%.14f,%.14f\n",
+            pfi, key, 10 + random_below(state, 15), 1 + random_below(state, 12),
+            1 + random_below(state, 28), address->unit > 0 ? "V" : "P",
+            random_below(state, 4) == 0 ? "PART" : "", address->unit > 0 ? "UNIT" : "",
+            unit_id, address->number, roads[address->road], road_types[address->road_type],
+            localities[address->locality], 3000 + address->locality,
+            access_types[random_below(state, 4)], x, y);
+}
+
+/*
+ * Makes a new address, unrelated to any before it
+ */
+static void fresh_address(gen_address_t *address, const gen_options_t *options,
+                          uint64_t *state) {
+    address->unit = random_below(state, 7) == 0 ? 1 + (int)random_below(state, 40) : 0;
+    address->number = 1 + (int)random_below(state, MAX_HOUSE_NUMBER - 1);
+    address->road = (int)random_below(state, options->num_roads);
+    address->road_type = (int)random_below(state, NUM_ROAD_TYPES);
+    address->locality = (int)random_below(state, options->num_localities);
+}
+
+/* -- Queries -- */
+
+/*
+ * Keys sampled uniformly from the dataset while it is written (reservoir
+ * sampling), for the hit and misspelled queries
+ * keys: the sampled keys, each MAX_KEY_LEN + 1 bytes
+ * capacity: number of keys to sample
+ * seen: number of keys offered so far
+*/
+typedef struct key_sample {
+    char *keys;
+    int capacity;
+    long seen;
+} key_sample_t;
+
+static void sample_key(key_sample_t *sample, const char *key, uint64_t *state) {
+    long slot = sample->seen < sample->capacity ? sample->seen
+                                                : random_below(state, sample->seen + 1);
+    if (slot < sample->capacity) {
+        strcpy(sample->keys + slot * (MAX_KEY_LEN + 1), key);
+    }
+    sample->seen++;
+}
+
+/*
+ * Applies one random edit to a letter of key: changes it, drops it, adds a
+ * letter after it or swaps it with the next character
+ */
+static void misspell(char *key, uint64_t *state) {
+    int len = strlen(key);
+    int letters[MAX_KEY_LEN];
+    int num_letters = 0;
+    for (int i = 0; i < len; i++) {
+        if (key[i] >= 'A' && key[i] <= 'Z') {
+            letters[num_letters++] = i;
+        }
+    }
+    if (num_letters == 0) {
+        return;
+    }
+
+    int pos = letters[random_below(state, num_letters)];
+    char letter = 'A' + random_below(state, 25);
+    switch (random_below(state, 4)) {
+        case 0: // Change
+            key[pos] = letter >= key[pos] ? letter + 1 : letter;
+            break;
+        case 1: // Drop
+            memmove(key + pos, key + pos + 1, len - pos);
+            break;
+        case 2: // Add
+            if (len < MAX_KEY_LEN) {
+                memmove(key + pos + 2, key + pos + 1, len - pos);
+                key[pos + 1] = letter;
+                break;
+            }
+            // A key at full length gets a swap instead
+            // Fall through
+        default: // Swap with the next character
+            if (key[pos + 1] != '\0' && key[pos + 1] != key[pos]) {
+                char tmp = key[pos];
+                key[pos] = key[pos + 1];
+                key[pos + 1] = tmp;
+            } else {
+                key[pos] = key[pos] == 'Z' ? 'A' : key[pos] + 1;
+            }
+            break;
+    }
+}
+
+/*
+ * Writes the queries: hits and misspellings from the sampled keys, misses
+ * made up on the dataset's roads, all shuffled together
+ */
+static void write_queries(FILE *f, const gen_options_t *options, key_sample_t *sample,
+                          char **roads, char **localities, uint64_t *state) {
+    int num_hits = (int)(options->num_queries * options->hit_ratio + 0.5);
+    int num_misspelled = (int)(options->num_queries * options->misspell_ratio + 0.5);
+    if (num_hits + num_misspelled > options->num_queries) {
+        num_misspelled = options->num_queries - num_hits;
+    }
+    int num_sampled = sample->seen < sample->capacity ? (int)sample->seen : sample->capacity;
+
+    char *queries = malloc((size_t)options->num_queries * (MAX_KEY_LEN + 1));
+    assert(queries);
+    for (int i = 0; i < options->num_queries; i++) {
+        char *query = queries + (size_t)i * (MAX_KEY_LEN + 1);
+        if (i < num_hits + num_misspelled) {
+            strcpy(query, sample->keys + (i % num_sampled) * (MAX_KEY_LEN + 1));
+            if (i >= num_hits) {
+                misspell(query, state);
+            }
+        } else {
+            // No record has a house number this high
+            gen_address_t address;
+            fresh_address(&address, options, state);
+            address.number = MAX_HOUSE_NUMBER + (int)random_below(state, MAX_HOUSE_NUMBER);
+            format_key(query, &address, roads, localities);
+        }
+    }
+
+    // Fisher-Yates shuffle of the query order
+    char tmp[MAX_KEY_LEN + 1];
+    for (int i = options->num_queries - 1; i > 0; i--) {
+        int j = (int)random_below(state, i + 1);
+        char *a = queries + (size_t)i * (MAX_KEY_LEN + 1);
+        char *b = queries + (size_t)j * (MAX_KEY_LEN + 1);
+        strcpy(tmp, a);
+        strcpy(a, b);
+        strcpy(b, tmp);
+    }
+
+    for (int i = 0; i < options->num_queries; i++) {
+        fprintf(f, "%s\n", queries + (size_t)i * (MAX_KEY_LEN + 1));
+    }
+    free(queries);
+
+    fprintf(stderr, "%d queries: %d hits, %d misspelled, %d misses\n", options->num_queries,
+            num_hits, num_misspelled, options->num_queries - num_hits - num_misspelled);
+}
+
+/*
+ * Parses the options after the three positional arguments.
+ * Returns 0 on success, -1 after printing an error.
+ */
+static int parse_options(int argc, char *argv[], gen_options_t *options) {
+    static const char *const names[] = {"--seed", "--roads", "--localities", "--key-len",
+                                        "--prefix-share", "--dup-ratio", "--queries", "--hit",
+                                        "--misspell"};
+    for (int i = 4; i < argc; i++) {
+        int known = 0;
+        for (size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++) {
+            known = known || strcmp(argv[i], names[n]) == 0;
+        }
+        if (!known) {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return -1;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Option %s needs a value\n", argv[i]);
+            return -1;
+        }
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i - 1], "--roads") == 0) {
+            options->num_roads = atoi(value);
+        } else if (strcmp(argv[i - 1], "--localities") == 0) {
+            options->num_localities = atoi(value);
+        } else if (strcmp(argv[i - 1], "--key-len") == 0) {
+            options->key_len = atoi(value);
+        } else if (strcmp(argv[i - 1], "--prefix-share") == 0) {
+            options->prefix_share = atof(value);
+        } else if (strcmp(argv[i - 1], "--dup-ratio") == 0) {
+            options->dup_ratio = atof(value);
+        } else if (strcmp(argv[i - 1], "--queries") == 0) {
+            options->num_queries = atoi(value);
+        } else if (strcmp(argv[i - 1], "--hit") == 0) {
+            options->hit_ratio = atof(value);
+        } else if (strcmp(argv[i - 1], "--misspell") == 0) {
+            options->misspell_ratio = atof(value);
+        }
+    }
+
+    if (options->rows <= 0 || options->num_roads <= 0 || options->num_localities <= 0
+        || options->num_localities > 6999 || options->num_queries < 0) {
+        fprintf(stderr, "rows and --roads need positive numbers, --localities 1 to 6999, "
+                        "--queries a non-negative number\n");
+        return -1;
+    }
+    if (options->key_len < KEY_FIXED_LEN + 3 || options->key_len > MAX_MEAN_KEY_LEN) {
+        fprintf(stderr, "--key-len needs %d to %d\n", KEY_FIXED_LEN + 3, MAX_MEAN_KEY_LEN);
+        return -1;
+    }
+    if (options->prefix_share < 0 || options->dup_ratio < 0
+        || options->prefix_share + options->dup_ratio > 1 || options->hit_ratio < 0
+        || options->misspell_ratio < 0 || options->hit_ratio + options->misspell_ratio > 1) {
+        fprintf(stderr, "--prefix-share and --dup-ratio, and --hit and --misspell, "
+                        "need fractions adding up to at most 1\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s rows output.csv queries.in [--seed S] [--roads N] "
+                        "[--localities N] [--key-len L] [--prefix-share P] [--dup-ratio D] "
+                        "[--queries Q] [--hit H] [--misspell M]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    gen_options_t options = {atol(argv[1]), 1, 5000, 400, 37, 0.2, 0.02, 10000, 0.6, 0.2};
+    if (parse_options(argc, argv, &options) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    FILE *dataFile = fopen(argv[2], "w");
+    if (!dataFile) {
+        perror("Error opening output file");
+        return EXIT_FAILURE;
+    }
+    FILE *queryFile = fopen(argv[3], "w");
+    if (!queryFile) {
+        perror("Error opening query file");
+        fclose(dataFile);
+        return EXIT_FAILURE;
+    }
+
+    // Vocabulary and records come from separate streams, so changing the
+    // sizes of one does not reshuffle the other
+    uint64_t vocab_state = options.seed * 3 + 1;
+    uint64_t state = options.seed * 3 + 2;
+    uint64_t query_state = options.seed * 3 + 3;
+
+    char **roads = make_names(&vocab_state, options.num_roads, options.key_len - KEY_FIXED_LEN);
+    char **localities = make_names(&vocab_state, options.num_localities, 9);
+
+    gen_address_t recent[RECENT_RECORDS];
+    key_sample_t sample = {NULL, options.num_queries, 0};
+    sample.keys = malloc((size_t)(sample.capacity > 0 ? sample.capacity : 1) * (MAX_KEY_LEN + 1));
+    assert(sample.keys);
+
+    fprintf(dataFile, "PFI,EZI_ADD,SRC_VERIF,PROPSTATUS,GCODEFEAT,LOC_DESC,BLGUNTTYP,HSAUNITID,"
+                      "BUNIT_PRE1,BUNIT_ID1,BUNIT_SUF1,BUNIT_PRE2,BUNIT_ID2,BUNIT_SUF2,FLOOR_TYPE,"
+                      "FLOOR_NO_1,FLOOR_NO_2,BUILDING,COMPLEX,HSE_PREF1,HSE_NUM1,HSE_SUF1,"
+                      "HSE_PREF2,HSE_NUM2,HSE_SUF2,DISP_NUM1,ROAD_NAME,ROAD_TYPE,RD_SUF,LOCALITY,"
+                      "STATE,POSTCODE,ACCESSTYPE,x,y\n");
+
+    long num_shared = 0;
+    long num_dups = 0;
+    long total_key_len = 0;
+    char key[MAX_KEY_LEN + 1];
+    for (long row = 0; row < options.rows; row++) {
+        gen_address_t address;
+        double kind = random_unit(&state);
+        long num_recent = row < RECENT_RECORDS ? row : RECENT_RECORDS;
+
+        if (num_recent > 0 && kind < options.dup_ratio) {
+            // Same key as a recent record
+            address = recent[random_below(&state, num_recent)];
+            num_dups++;
+        } else if (num_recent > 0 && options.num_localities > 1
+                   && kind < options.dup_ratio + options.prefix_share) {
+            // Same unit, number and road as a recent record, another locality
+            address = recent[random_below(&state, num_recent)];
+            address.locality = (address.locality + 1
+                                + (int)random_below(&state, options.num_localities - 1))
+                               % options.num_localities;
+            num_shared++;
+        } else {
+            fresh_address(&address, &options, &state);
+        }
+        recent[row % RECENT_RECORDS] = address;
+
+        total_key_len += format_key(key, &address, roads, localities);
+        write_record(dataFile, 400000000 + row, key, &address, roads, localities, &state);
+        sample_key(&sample, key, &query_state);
+    }
+
+    fprintf(stderr, "%ld records: mean key length %.1f, %ld sharing a prefix, %ld duplicates\n",
+            options.rows, (double)total_key_len / options.rows, num_shared, num_dups);
+
+    if (options.num_queries > 0) {
+        write_queries(queryFile, &options, &sample, roads, localities, &query_state);
+    }
+
+    free(sample.keys);
+    free_names(roads, options.num_roads);
+    free_names(localities, options.num_localities);
+    fclose(queryFile);
+    fclose(dataFile);
+
+    return EXIT_SUCCESS;
+}